@@ -1,41 +1,178 @@
+#define _GNU_SOURCE  /* wcwidth(), syscall() */
 #include <ncurses.h>
+#include <locale.h>
+#include <wchar.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
+#include <stdint.h>
+#include <poll.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
 
 /*
  * A Simplified Nano-Like Text Editor
  *
  * Controls:
  *   - Arrow keys: Move cursor around.
+ *   - Ctrl+Left/Right: Move to the previous/next word.
  *   - Printable keys: Insert characters.
  *   - Backspace: Delete character before cursor.
+ *   - Ctrl+Backspace/Ctrl+Delete: Delete the word before/after the cursor.
+ *   - Ctrl+T: Remove duplicate lines (keeps the first occurrence)
  *   - Ctrl+O: Save
+ *   - Ctrl+C: Cancel a long-running load, save or dedupe
  *   - Ctrl+X: Exit
  *
  * If a filename is provided as an argument, it will attempt to open it,
  * allowing editing of that file. If no file is provided, it starts with
- * an empty buffer.
+ * an empty buffer. A filename of "-" reads the buffer from standard input,
+ * showing lines as they arrive (e.g. "make 2>&1 | nano-clone -").
+ *
+ * "nano-clone --bench FILE" times the editing primitives on FILE instead
+ * of starting the editor; see editor_bench(). "nano-clone --bench-startup
+ * FILE" starts normally, then exits after the first frame and reports
+ * where the startup time went. "nano-clone --gen KIND BYTES
+ * FILE" writes a synthetic test file and "nano-clone --bench-scale KIND
+ * [MAX_MB]" measures how each primitive scales with file size; see
+ * editor_bench_scale().
+ *
+ * "nano-clone --script SCRIPT FILE..." applies the edit commands in SCRIPT
+ * to each FILE without opening the terminal; see editor_script().
+ *
+ * Text is handled as UTF-8 (link with -lncursesw to display it). Bytes that
+ * are not valid UTF-8 are shown as a highlighted '?'.
+ *
+ * Build: cc -O2 -o nano-clone nano-clone.c -lncursesw -lm
  *
  * This is a very simplified demonstration and not a complete clone of nano.
  */
 
+/*
+ * Allocation statistics: build with -DALLOC_STATS to count malloc, realloc,
+ * strdup and free calls (and bytes requested) by the kind of key being
+ * handled, plus screen redraws and file loading. The totals are printed to
+ * stderr on exit. Only the editor's own allocations are counted, not
+ * ncurses' or libc's; memory that libc allocated (realpath(), getline())
+ * is released with (free)(p), which bypasses the counting macro.
+ */
+#ifdef ALLOC_STATS
+enum {
+    OP_LOAD, OP_DRAW, OP_INSERT_CHAR, OP_DELETE_CHAR, OP_NEWLINE, OP_MOVE,
+    OP_WORD, OP_SAVE, OP_DEDUPE, OP_OTHER, OP_COUNT
+};
+
+static const char *const alloc_op_names[OP_COUNT] = {
+    "load", "draw", "insert char", "delete char", "newline", "move",
+    "word", "save", "dedupe", "other"
+};
+
+static struct {
+    long calls;     // keys handled (frames for OP_DRAW)
+    long allocs;
+    long frees;
+    long long bytes;
+} alloc_stats[OP_COUNT];
+static int alloc_op = OP_LOAD;
+
+static void *stats_malloc(size_t n) {
+    alloc_stats[alloc_op].allocs++;
+    alloc_stats[alloc_op].bytes += n;
+    return malloc(n);
+}
+
+static void *stats_realloc(void *p, size_t n) {
+    alloc_stats[alloc_op].allocs++;
+    alloc_stats[alloc_op].bytes += n;
+    if (p) alloc_stats[alloc_op].frees++;
+    return realloc(p, n);
+}
+
+static char *stats_strdup(const char *s) {
+    alloc_stats[alloc_op].allocs++;
+    alloc_stats[alloc_op].bytes += strlen(s) + 1;
+    return strdup(s);
+}
+
+static void stats_free(void *p) {
+    if (p) alloc_stats[alloc_op].frees++;
+    free(p);
+}
+
+static void alloc_stats_report(void) {
+    fprintf(stderr, "%-12s %10s %12s %12s %14s %10s\n",
+            "operation", "calls", "allocs", "frees", "bytes", "allocs/call");
+    for (int i = 0; i < OP_COUNT; i++) {
+        if (!alloc_stats[i].calls && !alloc_stats[i].allocs) continue;
+        fprintf(stderr, "%-12s %10ld %12ld %12ld %14lld %10.2f\n",
+                alloc_op_names[i], alloc_stats[i].calls, alloc_stats[i].allocs,
+                alloc_stats[i].frees, alloc_stats[i].bytes,
+                alloc_stats[i].calls ? (double)alloc_stats[i].allocs / alloc_stats[i].calls : 0.0);
+    }
+}
+
+#define malloc(n)     stats_malloc(n)
+#define realloc(p, n) stats_realloc(p, n)
+#define strdup(s)     stats_strdup(s)
+#define free(p)       stats_free(p)
+#define ALLOC_OP(op)  (alloc_op = (op), alloc_stats[alloc_op].calls++)
+#else
+#define ALLOC_OP(op)  ((void)0)
+#endif
+
 typedef struct {
-    char **lines;   // Array of lines
+    char *text;     // Line contents, NUL-terminated
+    int len;        // Length of text in bytes
+    int cap;        // Bytes allocated for text
+    int flags;      // LINE_* properties of text
+    int mark_col;   // A character start before the screen's left edge...
+    int mark_x;     // ...and its screen column; see line_col_to_x()
+} EditorLine;
+
+enum {
+    LINE_ASCII = 1, // Only 7-bit bytes: one byte per screen cell
+    LINE_UTF8  = 2  // Valid UTF-8 (set for ASCII lines too)
+};
+
+typedef struct {
+    EditorLine *lines; // Array of lines
     int numlines;   // Number of lines in the buffer
+    int linecap;    // Number of entries allocated in lines
     int row;        // Cursor position in terms of lines
     int col;        // Cursor position in terms of characters
     int topline;    // The line number currently at the top of the screen
-    int leftcol;    // The column number currently at the left of the screen
+    int leftcol;    // The screen column currently at the left of the screen
+    int cx;         // Screen column of the cursor within its line
     int screenrows; // Number of rows in the terminal
     int screencols; // Number of columns in the terminal
     char *filename; // Name of the file currently editing
     int modified;   // Has the file been modified?
+    int encoding;   // Encoding of the file on disk (ENC_*); lines are UTF-8
 } EditorState;
 
+enum { ENC_UTF8, ENC_LATIN1, ENC_UTF16LE };
+
 static EditorState E;
 
+static int term_infd = STDIN_FILENO;   // where ncurses reads keys from
+static int term_outfd = STDOUT_FILENO; // where ncurses writes the screen
+static int headless;        // --script: no ncurses, messages are kept
+static char last_status[80]; // last message in headless mode
+
+#define KEY_QUEUE_SIZE 256
+static int key_queue[KEY_QUEUE_SIZE]; // keys read during a long operation
+static int key_head, key_count;
+
 /* Forward declarations */
 void editor_init(const char *filename);
 void editor_free(void);
@@ -46,26 +183,108 @@ void editor_process_key(int c);
 void editor_insert_char(char ch);
 void editor_delete_char(void);
 void editor_insert_line(int at, const char *s);
+void editor_insert_line_len(int at, const char *s, int len);
 void editor_delete_line(int at);
+void editor_delete_lines(int at, int count);
+void editor_dedupe_lines(void);
+int  editor_replace_all(const char *from, const char *to);
+void editor_move_word(int forward);
+void editor_delete_word(int forward);
 void editor_status_message(const char *msg);
+int  editor_wait_event(int timeout_ms);
+void editor_open_stream(void);
+int  editor_stream_fd(void);
+void editor_read_stream(void);
+void editor_progress_begin(int cancellable);
+int  editor_progress(const char *what, long long done, long long total);
+void editor_process_pending_keys(void);
+int  editor_read_key(void);
+int  editor_bench(const char *filename);
+void editor_report_startup(long long start, long long after_initscr,
+                           long long after_init, long long after_frame);
+static long long now_ns(void);
+int  editor_generate(const char *kind, long long bytes, const char *filename);
+int  editor_bench_scale(const char *kind, int max_mb);
+int  editor_script(const char *script, int nfiles, char **files);
+static long long now_ms(void);
+
+/*
+ * Upper bound on screen refreshes per second. Under sustained input (key
+ * repeat, pastes) keys are handled as they come but the screen is redrawn
+ * at most this often; the first key after a pause is drawn immediately.
+ */
+#ifndef MAX_FPS
+#define MAX_FPS 60
+#endif
+#define FRAME_MS (1000 / MAX_FPS)
 
 int main(int argc, char *argv[]) {
     const char *filename = NULL;
     if (argc > 1) filename = argv[1];
+    if (argc > 2 && strcmp(argv[1], "--bench") == 0)
+        return editor_bench(argv[2]);
+    if (argc > 4 && strcmp(argv[1], "--gen") == 0)
+        return editor_generate(argv[2], atoll(argv[3]), argv[4]);
+    if (argc > 2 && strcmp(argv[1], "--bench-scale") == 0)
+        return editor_bench_scale(argv[2], argc > 3 ? atoi(argv[3]) : 64);
+    if (argc > 3 && strcmp(argv[1], "--script") == 0)
+        return editor_script(argv[2], argc - 3, argv + 3);
+    int bench_startup = argc > 2 && strcmp(argv[1], "--bench-startup") == 0;
+    if (bench_startup) filename = argv[2];
 
-    initscr();
+#ifdef ALLOC_STATS
+    atexit(alloc_stats_report);
+#endif
+    // With "-" the file comes from standard input, so the terminal has to
+    // be opened separately for the keyboard and screen.
+    int from_stdin = filename && strcmp(filename, "-") == 0;
+    if (from_stdin) filename = NULL;
+
+    long long t_start = now_ns();
+    setlocale(LC_ALL, "");
+    if (from_stdin) {
+        FILE *tty = fopen("/dev/tty", "r+");
+        if (!tty || !newterm(NULL, tty, tty)) {
+            fprintf(stderr, "nano-clone: cannot open the terminal (/dev/tty)\n");
+            return 1;
+        }
+        term_infd = term_outfd = fileno(tty);
+    } else {
+        initscr();
+    }
     raw();               // raw input (no line buffering)
     noecho();            // don't echo characters typed
     keypad(stdscr, TRUE);
     curs_set(1);         // show the cursor
-    start_color();
+    long long t_initscr = now_ns();
 
     editor_init(filename);
+    if (from_stdin) editor_open_stream();
+    long long t_init = now_ns();
+
+    // Draw the first frame before anything that is not needed for it
+    editor_refresh_screen();
+    long long t_frame = now_ns();
+    start_color();
+
+    if (bench_startup) {
+        endwin();
+        editor_report_startup(t_start, t_initscr, t_init, t_frame);
+        editor_free();
+        return 0;
+    }
 
     while (1) {
+        long long last_frame = now_ms();
+        editor_wait_event(-1);
+        editor_process_pending_keys();
+
+        // If the last frame was drawn less than FRAME_MS ago, keep handling
+        // input until the next one is due instead of redrawing per batch.
+        long long wait;
+        while ((wait = last_frame + FRAME_MS - now_ms()) > 0 && editor_wait_event((int)wait) > 0)
+            editor_process_pending_keys();
         editor_refresh_screen();
-        int c = getch();
-        editor_process_key(c);
     }
 
     endwin();
@@ -73,35 +292,98 @@ int main(int argc, char *argv[]) {
     return 0;
 }
 
+void editor_process_pending_keys(void) {
+    // Handle every key that is already pending before repainting, so a
+    // paste or key-repeat burst costs one frame instead of one per key.
+    // Keys are processed in blocking mode because some of them (Ctrl+X)
+    // wait for a follow-up key.
+    int c;
+    nodelay(stdscr, TRUE);
+    while ((c = editor_read_key()) != ERR) {
+        nodelay(stdscr, FALSE);
+        editor_process_key(c);
+        nodelay(stdscr, TRUE);
+    }
+    nodelay(stdscr, FALSE);
+}
+
+int editor_wait_event(int timeout_ms) {
+    // Sleep until the terminal or the input stream has data, or the timeout
+    // expires. Stream data is read right away. A signal (e.g. SIGWINCH)
+    // interrupts the wait too; ncurses then reports it as KEY_RESIZE from
+    // the next getch(). Returns the number of ready sources, 0 on timeout.
+    // Keys held back during a long operation are already waiting.
+    if (key_count > 0) return 1;
+    struct pollfd fds[2];
+    int nfds = 1;
+    fds[0].fd = term_infd;
+    fds[0].events = POLLIN;
+    if (editor_stream_fd() >= 0) {
+        fds[1].fd = editor_stream_fd();
+        fds[1].events = POLLIN;
+        nfds = 2;
+    }
+    int n = poll(fds, nfds, timeout_ms);
+    if (n < 0 && errno == EINTR) return 1;
+    if (n > 0 && nfds == 2 && fds[1].revents)
+        editor_read_stream();
+    return n;
+}
+
+/*
+ * Terminals report Ctrl+arrow and Ctrl+Delete with modifier sequences that
+ * have no fixed ncurses key code; look up what this terminal's terminfo
+ * assigned to them. 0 means the terminal does not have the key.
+ */
+static int key_ctrl_left, key_ctrl_right, key_ctrl_delete;
+
+static int lookup_key(const char *capname) {
+    char *seq = tigetstr(capname);
+    if (seq == NULL || seq == (char *)-1) return 0;
+    int code = key_defined(seq);
+    return code > 0 ? code : 0;
+}
+
+static long long startup_load_ns; // time spent loading the initial file
+
 void editor_init(const char *filename) {
     getmaxyx(stdscr, E.screenrows, E.screencols);
+    key_ctrl_left = lookup_key("kLFT5");
+    key_ctrl_right = lookup_key("kRIT5");
+    key_ctrl_delete = lookup_key("kDC5");
 
     // Reserve last 3 lines for status bars/help lines
     E.screenrows -= 3;
 
     E.numlines = 0;
+    E.linecap = 0;
     E.lines = NULL;
     E.row = 0;
     E.col = 0;
     E.topline = 0;
     E.leftcol = 0;
+    E.cx = 0;
     E.modified = 0;
+    E.encoding = ENC_UTF8;
     E.filename = NULL;
 
+    // Show the help first so errors or a cancel from loading replace it.
+    editor_status_message("HELP: Ctrl+O = Save | Ctrl+T = Dedupe | Ctrl+X = Exit");
+
     if (filename) {
         E.filename = strdup(filename);
+        long long t = now_ns();
         editor_load_file(filename);
+        startup_load_ns = now_ns() - t;
     } else {
         editor_insert_line(0, "");
     }
-
-    editor_status_message("HELP: Ctrl+O = Save | Ctrl+X = Exit");
 }
 
 void editor_free(void) {
     if (E.filename) free(E.filename);
     for (int i = 0; i < E.numlines; i++) {
-        free(E.lines[i]);
+        free(E.lines[i].text);
     }
     free(E.lines);
 }
@@ -110,6 +392,10 @@ void editor_status_message(const char *msg) {
     // We store a short message that can be displayed in the status bar area.
     // In this simplified version, we’ll just print immediately during refresh.
     // For a more robust solution, store and print it on refresh.
+    if (headless) {
+        snprintf(last_status, sizeof(last_status), "%s", msg);
+        return;
+    }
     move(E.screenrows + 1, 0);
     clrtoeol();
     attron(A_REVERSE);
@@ -117,9 +403,366 @@ void editor_status_message(const char *msg) {
     attroff(A_REVERSE);
 }
 
+/*
+ * Long operations (load, save, dedupe) call editor_progress() every
+ * PROGRESS_CHUNK lines or PROGRESS_BYTES bytes, so long lines do not delay
+ * a cancel. It repaints the status line with percentage and ETA a few
+ * times per second and returns 1 if the user pressed Ctrl+C, in which case
+ * the caller must undo whatever it has done so far. Other keys typed
+ * meanwhile are kept in key_queue and handled once the operation is over.
+ * An operation that cannot be undone passes cancellable = 0 to
+ * editor_progress_begin(); it only shows progress and leaves keys alone.
+ */
+#define PROGRESS_CHUNK 16384      // lines between editor_progress() calls
+#define PROGRESS_BYTES (1 << 20)  // or bytes, whichever comes first
+#define PROGRESS_REPAINT_MS 100
+
+static long long progress_start_ms;
+static long long progress_paint_ms;
+static int progress_cancellable;
+
+int editor_read_key(void) {
+    // Keys held back by editor_progress() come first, then the terminal
+    if (key_count > 0) {
+        int c = key_queue[key_head];
+        key_head = (key_head + 1) % KEY_QUEUE_SIZE;
+        key_count--;
+        return c;
+    }
+    return getch();
+}
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void editor_progress_begin(int cancellable) {
+    progress_start_ms = progress_paint_ms = now_ms();
+    progress_cancellable = cancellable;
+}
+
+int editor_progress(const char *what, long long done, long long total) {
+    if (headless) return 0;
+    struct pollfd pfd = { .fd = term_infd, .events = POLLIN };
+    if (progress_cancellable && poll(&pfd, 1, 0) > 0) {
+        // Read everything that is waiting, so a Ctrl+C typed after other
+        // keys is still seen. Keys beyond the queue's size are dropped.
+        int c, cancel = 0;
+        nodelay(stdscr, TRUE);
+        while ((c = getch()) != ERR) {
+            if (c == 3) { // Ctrl+C
+                cancel = 1;
+                break;
+            }
+            if (key_count < KEY_QUEUE_SIZE)
+                key_queue[(key_head + key_count++) % KEY_QUEUE_SIZE] = c;
+        }
+        nodelay(stdscr, FALSE);
+        if (cancel) return 1;
+    }
+
+    long long now = now_ms();
+    if (now - progress_paint_ms < PROGRESS_REPAINT_MS) return 0;
+    progress_paint_ms = now;
+
+    char msg[80];
+    const char *hint = progress_cancellable ? ", ^C to cancel" : "";
+    if (total > 0 && done > 0) {
+        long long eta = (now - progress_start_ms) * (total - done) / done;
+        snprintf(msg, sizeof(msg), "%s... %d%% (about %llds left%s)",
+                 what, (int)(done * 100 / total), (eta + 999) / 1000, hint);
+    } else {
+        snprintf(msg, sizeof(msg), "%s...%s", what,
+                 progress_cancellable ? " (^C to cancel)" : "");
+    }
+    editor_status_message(msg);
+    refresh();
+    return 0;
+}
+
+/*
+ * File I/O goes through plain read()/write() in IO_CHUNK blocks instead of
+ * stdio: one syscall per megabyte rather than per line or per 4 KiB buffer,
+ * and lines are split out of the read buffer with memchr() in place.
+ */
+#define IO_CHUNK (1 << 20)
+
+static void append_bytes(char **buf, size_t *len, size_t *cap, const char *s, size_t n) {
+    if (*len + n + 1 > *cap) {
+        *cap = (*len + n + 1) * 2;
+        *buf = realloc(*buf, *cap);
+    }
+    memcpy(*buf + *len, s, n);
+    *len += n;
+    (*buf)[*len] = '\0';
+}
+
+static int write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/*
+ * Files in Latin-1 or UTF-16LE are converted to UTF-8 one read block at a
+ * time as they are loaded, and converted back line by line when saved, so
+ * the rest of the editor only ever sees UTF-8. The converters copy runs of
+ * ASCII eight bytes at a time, which is the common case for logs.
+ */
+static int utf8_decode(const unsigned char *s, size_t n, uint32_t *cp) {
+    // Returns the length of the sequence at s, 0 if it is invalid, or -1 if
+    // it is valid so far but cut off by the end of the input.
+    static const uint32_t min_cp[5] = { 0, 0, 0x80, 0x800, 0x10000 };
+    int len;
+    if (s[0] < 0x80) { *cp = s[0]; return 1; }
+    else if ((s[0] & 0xE0) == 0xC0) { len = 2; *cp = s[0] & 0x1F; }
+    else if ((s[0] & 0xF0) == 0xE0) { len = 3; *cp = s[0] & 0x0F; }
+    else if ((s[0] & 0xF8) == 0xF0) { len = 4; *cp = s[0] & 0x07; }
+    else return 0;
+    for (int i = 1; i < len; i++) {
+        if ((size_t)i >= n) return -1;
+        if ((s[i] & 0xC0) != 0x80) return 0;
+        *cp = (*cp << 6) | (s[i] & 0x3F);
+    }
+    if (*cp < min_cp[len] || *cp > 0x10FFFF || (*cp >= 0xD800 && *cp <= 0xDFFF))
+        return 0;
+    return len;
+}
+
+static char *utf8_encode(char *out, uint32_t cp) {
+    if (cp < 0x80) {
+        *out++ = cp;
+    } else if (cp < 0x800) {
+        *out++ = 0xC0 | (cp >> 6);
+        *out++ = 0x80 | (cp & 0x3F);
+    } else if (cp < 0x10000) {
+        *out++ = 0xE0 | (cp >> 12);
+        *out++ = 0x80 | ((cp >> 6) & 0x3F);
+        *out++ = 0x80 | (cp & 0x3F);
+    } else {
+        *out++ = 0xF0 | (cp >> 18);
+        *out++ = 0x80 | ((cp >> 12) & 0x3F);
+        *out++ = 0x80 | ((cp >> 6) & 0x3F);
+        *out++ = 0x80 | (cp & 0x3F);
+    }
+    return out;
+}
+
+static int detect_encoding(const unsigned char *s, size_t n) {
+    // A UTF-16LE byte order mark, otherwise UTF-8 unless the first block
+    // has bytes that cannot be UTF-8 and no multi-byte UTF-8 characters at
+    // all, in which case assume Latin-1. A UTF-8 file with a few stray bytes
+    // stays UTF-8 and shows them as invalid.
+    if (n >= 2 && s[0] == 0xFF && s[1] == 0xFE) return ENC_UTF16LE;
+    uint32_t cp;
+    int invalid = 0;
+    for (size_t i = 0; i < n; ) {
+        int len = utf8_decode(s + i, n - i, &cp);
+        if (len < 0) break;
+        if (len > 1) return ENC_UTF8;
+        if (len == 0) invalid = 1;
+        i += len > 0 ? len : 1;
+    }
+    return invalid ? ENC_LATIN1 : ENC_UTF8;
+}
+
+static size_t latin1_to_utf8(const unsigned char *in, size_t n, char *out) {
+    // Output needs up to 2 * n bytes
+    char *o = out;
+    size_t i = 0;
+    while (i < n) {
+        uint64_t w;
+        if (i + 8 <= n && (memcpy(&w, in + i, 8), (w & 0x8080808080808080ull) == 0)) {
+            memcpy(o, in + i, 8);
+            o += 8;
+            i += 8;
+            continue;
+        }
+        o = utf8_encode(o, in[i++]);
+    }
+    return o - out;
+}
+
+static size_t utf16le_to_utf8(const unsigned char *in, size_t n, char *out, size_t *consumed) {
+    // Output needs up to 2 * n bytes. Stops before a code unit or surrogate
+    // pair that is cut off by the end of the input; *consumed says where.
+    char *o = out;
+    size_t i = 0;
+    while (i + 2 <= n) {
+        if (i + 8 <= n && (in[i+1] | in[i+3] | in[i+5] | in[i+7]) == 0 &&
+            ((in[i] | in[i+2] | in[i+4] | in[i+6]) & 0x80) == 0) {
+            o[0] = in[i]; o[1] = in[i+2]; o[2] = in[i+4]; o[3] = in[i+6];
+            o += 4;
+            i += 8;
+            continue;
+        }
+        uint32_t cp = in[i] | (in[i+1] << 8);
+        if (cp >= 0xD800 && cp <= 0xDBFF) {
+            if (i + 4 > n) break;
+            uint32_t lo = in[i+2] | (in[i+3] << 8);
+            if (lo >= 0xDC00 && lo <= 0xDFFF) {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                i += 2;
+            } else {
+                cp = 0xFFFD;
+            }
+        } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+            cp = 0xFFFD;
+        }
+        o = utf8_encode(o, cp);
+        i += 2;
+    }
+    *consumed = i;
+    return o - out;
+}
+
+static size_t encode_line(const EditorLine *l, char *out) {
+    // Converts a line plus its newline to E.encoding. Output needs up to
+    // 2 * len + 2 bytes. Characters Latin-1 cannot hold are written as '?'.
+    const unsigned char *s = (const unsigned char *)l->text;
+    char *o = out;
+    size_t i = 0, n = l->len;
+    if (E.encoding == ENC_UTF8) {
+        memcpy(o, s, n);
+        o[n] = '\n';
+        return n + 1;
+    }
+    while (i < n) {
+        uint32_t cp;
+        int len = utf8_decode(s + i, n - i, &cp);
+        if (len <= 0) {
+            cp = s[i];  // not UTF-8: pass the byte through
+            len = 1;
+        }
+        i += len;
+        if (E.encoding == ENC_LATIN1) {
+            *o++ = cp <= 0xFF ? (char)cp : '?';
+        } else if (cp >= 0x10000) {
+            cp -= 0x10000;
+            uint32_t hi = 0xD800 + (cp >> 10), lo = 0xDC00 + (cp & 0x3FF);
+            *o++ = hi & 0xFF; *o++ = hi >> 8;
+            *o++ = lo & 0xFF; *o++ = lo >> 8;
+        } else {
+            *o++ = cp & 0xFF; *o++ = cp >> 8;
+        }
+    }
+    *o++ = '\n';
+    if (E.encoding == ENC_UTF16LE) *o++ = '\0';
+    return o - out;
+}
+
+/*
+ * A LineReader turns a file descriptor into buffer lines one read() at a
+ * time: it detects and converts the encoding on the first block, appends
+ * every complete line to the end of the buffer and carries the rest over
+ * to the next block. editor_load_file() drives it in a loop; a stream on
+ * standard input is fed from the event loop as data arrives.
+ */
+typedef struct {
+    int fd;
+    unsigned char *raw; // read buffer
+    char *dec;          // raw converted to UTF-8, when not UTF-8 already
+    size_t carry;       // undecoded UTF-16 bytes kept for the next read
+    char *part;         // start of a line that continues into the next read
+    size_t partlen, partcap;
+    long long done;     // bytes read so far
+    int replace_empty;  // drop the buffer's placeholder empty line first,
+                        // unless it has been edited
+} LineReader;
+
+static void reader_init(LineReader *r, int fd) {
+    memset(r, 0, sizeof(*r));
+    r->fd = fd;
+    r->raw = malloc(IO_CHUNK + 4);
+    r->dec = malloc(2 * (size_t)IO_CHUNK + 8);
+}
+
+static void reader_add_line(LineReader *r, const char *s, size_t len) {
+    if (r->replace_empty) {
+        if (!E.modified && E.numlines == 1 && E.lines[0].len == 0) {
+            free(E.lines[0].text);
+            E.numlines = 0;
+        }
+        r->replace_empty = 0;
+    }
+    editor_insert_line_len(E.numlines, s, (int)len);
+}
+
+static ssize_t reader_feed(LineReader *r) {
+    // One read(): returns bytes read, 0 at end of input, or -1 with errno
+    ssize_t n = read(r->fd, r->raw + r->carry, IO_CHUNK);
+    if (n <= 0) return n;
+
+    unsigned char *in = r->raw;
+    size_t avail = r->carry + n, used = avail;
+    if (r->done == 0) {
+        E.encoding = detect_encoding(r->raw, avail);
+        if (E.encoding == ENC_UTF16LE) {
+            in += 2;  // skip the byte order mark
+            avail -= 2;
+            used = avail;
+        }
+    }
+    r->done += n;
+
+    char *buf;
+    size_t buflen;
+    if (E.encoding == ENC_LATIN1) {
+        buflen = latin1_to_utf8(in, avail, r->dec);
+        buf = r->dec;
+    } else if (E.encoding == ENC_UTF16LE) {
+        buflen = utf16le_to_utf8(in, avail, r->dec, &used);
+        buf = r->dec;
+    } else {
+        buflen = avail;
+        buf = (char *)in;
+    }
+    r->carry = avail - used;
+    memmove(r->raw, in + used, r->carry);
+
+    char *p = buf, *end = buf + buflen, *nl;
+    while ((nl = memchr(p, '\n', end - p)) != NULL) {
+        if (r->partlen > 0) {
+            append_bytes(&r->part, &r->partlen, &r->partcap, p, nl - p);
+            reader_add_line(r, r->part, r->partlen);
+            r->partlen = 0;
+        } else {
+            reader_add_line(r, p, nl - p);
+        }
+        p = nl + 1;
+    }
+    if (p < end)
+        append_bytes(&r->part, &r->partlen, &r->partcap, p, end - p);
+    return n;
+}
+
+static void reader_finish(LineReader *r) {
+    // A UTF-16 file cut off in the middle of a character
+    if (r->carry > 0)
+        append_bytes(&r->part, &r->partlen, &r->partcap, "\xEF\xBF\xBD", 3);
+    // Last line without a trailing newline
+    if (r->partlen > 0) {
+        if (r->part[r->partlen-1] == '\r')
+            r->partlen--;
+        reader_add_line(r, r->part, r->partlen);
+    }
+    free(r->raw);
+    free(r->dec);
+    free(r->part);
+}
+
 void editor_load_file(const char *filename) {
-    FILE *fp = fopen(filename, "r");
-    if (!fp) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
         if (errno == ENOENT) {
             // File does not exist, start empty
             editor_insert_line(0, "");
@@ -132,23 +775,99 @@ void editor_load_file(const char *filename) {
         }
     }
 
-    char *line = NULL;
-    size_t cap = 0;
-    ssize_t len;
+    struct stat st;
+    long long total = fstat(fd, &st) == 0 ? (long long)st.st_size : 0;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
 
-    while ((len = getline(&line, &cap, fp)) != -1) {
-        // Strip newline
-        if (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r'))
-            line[len-1] = '\0';
-        editor_insert_line(E.numlines, line);
+    LineReader r;
+    reader_init(&r, fd);
+    ssize_t n;
+
+    editor_progress_begin(1);
+    while ((n = reader_feed(&r)) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            editor_status_message("Error reading file.");
+            break;
+        }
+        if (editor_progress("Loading", r.done, total)) {
+            // Cancelled: drop the partial buffer and forget the filename, so
+            // a later save cannot truncate the file to what was loaded.
+            r.partlen = r.carry = 0;
+            reader_finish(&r);
+            close(fd);
+            E.encoding = ENC_UTF8;
+            while (E.numlines > 0) free(E.lines[--E.numlines].text);
+            free(E.filename);
+            E.filename = NULL;
+            editor_insert_line(0, "");
+            E.modified = 0;
+            editor_status_message("Load cancelled.");
+            return;
+        }
     }
-    free(line);
-    fclose(fp);
+    reader_finish(&r);
+    close(fd);
 
     if (E.numlines == 0)
         editor_insert_line(0, "");
 }
 
+/*
+ * "nano-clone -" edits whatever is piped in. Standard input is read without
+ * blocking from the event loop, so lines show up as they arrive while the
+ * keyboard is read from /dev/tty. Anything typed before the first line
+ * arrives is kept, and the input is added after it.
+ */
+static LineReader stream;
+static int stream_open;
+static int stream_flags = -1; // standard input's flags before O_NONBLOCK
+
+static void stream_restore_flags(void) {
+    // Standard input may be shared with the shell (e.g. the terminal)
+    if (stream_flags != -1) fcntl(STDIN_FILENO, F_SETFL, stream_flags);
+    stream_flags = -1;
+}
+
+void editor_open_stream(void) {
+    stream_flags = fcntl(STDIN_FILENO, F_GETFL);
+    if (stream_flags != -1) {
+        fcntl(STDIN_FILENO, F_SETFL, stream_flags | O_NONBLOCK);
+        atexit(stream_restore_flags);
+    }
+    reader_init(&stream, STDIN_FILENO);
+    stream.replace_empty = 1;
+    stream_open = 1;
+    E.modified = 0;
+    editor_status_message("Reading standard input...");
+}
+
+int editor_stream_fd(void) {
+    return stream_open ? stream.fd : -1;
+}
+
+void editor_read_stream(void) {
+    ssize_t n = reader_feed(&stream);
+    int err = errno;
+    int more = n > 0 || (n < 0 && (err == EAGAIN || err == EINTR));
+    if (!more) {
+        // End of input (or an error): add any unterminated last line
+        reader_finish(&stream);
+        stream_open = 0;
+        stream_restore_flags();
+    }
+    if (E.row >= E.numlines) E.row = E.numlines - 1;
+    if (E.col > E.lines[E.row].len) E.col = E.lines[E.row].len;
+    if (more) return;
+
+    char msg[80];
+    if (n < 0)
+        snprintf(msg, sizeof(msg), "Error reading standard input: %s", strerror(err));
+    else
+        snprintf(msg, sizeof(msg), "Read %d lines from standard input", E.numlines);
+    editor_status_message(msg);
+}
+
 int editor_save_file(void) {
     if (E.filename == NULL) {
         // For simplicity, if no filename provided at start,
@@ -156,58 +875,459 @@ int editor_save_file(void) {
         E.filename = strdup("untitled.txt");
     }
 
-    FILE *fp = fopen(E.filename, "w");
-    if (!fp) {
-        editor_status_message("Error: Cannot open file for writing!");
-        return -1;
+    // Write to a temporary file next to the target and rename it over the
+    // original, so a cancelled or failed save leaves the old file intact.
+    // A symlink is followed so the link stays a link. Files with other hard
+    // links, or whose owner we cannot give the temporary file, or in a
+    // directory we cannot create files in, are rewritten in place instead.
+    // path comes from libc either way and is released with (free)()
+    char *path = realpath(E.filename, NULL);
+    if (path == NULL) path = (strdup)(E.filename);
+    struct stat st;
+    int exists = stat(path, &st) == 0;
+    char *tmpname = NULL;
+    int fd = -1;
+    if (!exists || st.st_nlink == 1) {
+        size_t namelen = strlen(path);
+        tmpname = malloc(namelen + 8);
+        memcpy(tmpname, path, namelen);
+        memcpy(tmpname + namelen, ".XXXXXX", 8);
+        fd = mkstemp(tmpname);
+        if (fd >= 0 && exists && fchown(fd, st.st_uid, st.st_gid) != 0 &&
+            (st.st_uid != geteuid() || st.st_gid != getegid())) {
+            close(fd);
+            unlink(tmpname);
+            fd = -1;
+        }
+        if (fd < 0) {
+            free(tmpname);
+            tmpname = NULL;
+        }
+    }
+    if (tmpname) {
+        // mkstemp creates the file 0600; give it the original's permissions,
+        // or the usual ones for a new file.
+        if (exists) {
+            fchmod(fd, st.st_mode & 07777);
+        } else {
+            mode_t mask = umask(0);
+            umask(mask);
+            fchmod(fd, 0666 & ~mask);
+        }
+    } else {
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd < 0) {
+            (free)(path);
+            editor_status_message("Error: Cannot open file for writing!");
+            return -1;
+        }
     }
 
-    for (int i = 0; i < E.numlines; i++) {
-        fprintf(fp, "%s\n", E.lines[i]);
+    char *out = malloc(IO_CHUNK);
+    size_t used = 0;
+    int failed = 0;
+    if (E.encoding == ENC_UTF16LE) {
+        memcpy(out, "\xFF\xFE", 2);
+        used = 2;
     }
+    // Rewriting in place cannot be rolled back, so it is not cancellable
+    editor_progress_begin(tmpname != NULL);
+    long long pending = 0; // bytes since the last progress check
+    for (int i = 0; i < E.numlines && !failed; i++) {
+        size_t len = E.lines[i].len;
+        pending += len + 1;
+        size_t need = E.encoding == ENC_UTF8 ? len + 1 : 2 * len + 2;
+        if (used + need > IO_CHUNK) {
+            failed = write_all(fd, out, used);
+            used = 0;
+        }
+        if (need > IO_CHUNK) {
+            // Longer than the whole buffer: write it on its own
+            if (E.encoding == ENC_UTF8) {
+                failed = failed || write_all(fd, E.lines[i].text, len) || write_all(fd, "\n", 1);
+            } else {
+                char *big = malloc(need);
+                failed = failed || write_all(fd, big, encode_line(&E.lines[i], big));
+                free(big);
+            }
+        } else {
+            used += encode_line(&E.lines[i], out + used);
+        }
+        if ((i + 1) % PROGRESS_CHUNK == 0 || pending >= PROGRESS_BYTES) {
+            pending = 0;
+            if (editor_progress("Saving", i + 1, E.numlines)) {
+                free(out);
+                close(fd);
+                unlink(tmpname);
+                free(tmpname);
+                (free)(path);
+                editor_status_message("Save cancelled.");
+                return -1;
+            }
+        }
+    }
+    if (!failed) failed = write_all(fd, out, used);
+    free(out);
 
-    fclose(fp);
+    if (!failed && fsync(fd) != 0) failed = 1;
+    if (close(fd) != 0) failed = 1;
+    if (tmpname && (failed || rename(tmpname, path) != 0)) {
+        unlink(tmpname);
+        failed = 1;
+    }
+    free(tmpname);
+    (free)(path);
+    if (failed) {
+        editor_status_message("Error: Cannot write file!");
+        return -1;
+    }
     E.modified = 0;
     editor_status_message("File saved successfully!");
     return 0;
 }
 
-void editor_insert_line(int at, const char *s) {
+/*
+ * Lines keep their length and some spare capacity, so inserting a character
+ * is a memmove of the tail rather than a fresh allocation and a copy of the
+ * whole line, and nothing needs strlen() to find the end of a line. The line
+ * array grows geometrically for the same reason.
+ */
+static void line_reserve(EditorLine *l, int need) {
+    if (need <= l->cap) return;
+    int cap = l->cap * 2;
+    if (cap < need) cap = need;
+    if (cap < 16) cap = 16;
+    l->text = realloc(l->text, cap);
+    l->cap = cap;
+}
+
+/*
+ * Every line is classified when it enters the buffer (which during load
+ * means as the file is scanned). Drawing and cursor motion use plain byte
+ * offsets for ASCII lines and only decode UTF-8 for the others, where
+ * wide characters take two screen cells and combining marks none. Invalid
+ * bytes and non-printing characters count as one cell each.
+ */
+static void line_update_flags(EditorLine *l) {
+    const unsigned char *s = (const unsigned char *)l->text;
+    size_t i = 0, n = l->len;
+    while (i + 8 <= n) {
+        uint64_t w;
+        memcpy(&w, s + i, 8);
+        if (w & 0x8080808080808080ull) break;
+        i += 8;
+    }
+    l->flags = LINE_ASCII | LINE_UTF8;
+    while (i < n) {
+        if (s[i] < 0x80) {
+            i++;
+            continue;
+        }
+        l->flags &= ~LINE_ASCII;
+        uint32_t cp;
+        int len = utf8_decode(s + i, n - i, &cp);
+        if (len <= 0) {
+            l->flags &= ~LINE_UTF8;
+            return;
+        }
+        i += len;
+    }
+}
+
+static int line_char_len(const EditorLine *l, int col) {
+    // Bytes in the character at col: 1 for ASCII and for invalid bytes
+    if (l->flags & LINE_ASCII) return 1;
+    uint32_t cp;
+    int len = utf8_decode((const unsigned char *)l->text + col, l->len - col, &cp);
+    return len > 0 ? len : 1;
+}
+
+static int char_width(const unsigned char *s, int n, int *len) {
+    // Screen cells for the character at s, with its length in *len; -1
+    // for an invalid byte or a non-printing character, shown as one cell
+    uint32_t cp;
+    *len = utf8_decode(s, n, &cp);
+    if (*len <= 0) {
+        *len = 1;
+        return -1;
+    }
+    if (cp < 0x80) return 1;
+    int w = wcwidth((wchar_t)cp);
+    return w < 0 ? -1 : w;
+}
+
+static int line_char_width(const EditorLine *l, int col) {
+    if (l->flags & LINE_ASCII) return 1;
+    int len;
+    int w = char_width((const unsigned char *)l->text + col, l->len - col, &len);
+    return w < 0 ? 1 : w;
+}
+
+static int line_next_col(const EditorLine *l, int col) {
+    // Combining marks go with the character before them
+    col += line_char_len(l, col);
+    if (l->flags & LINE_ASCII) return col;
+    while (col < l->len && line_char_width(l, col) == 0)
+        col += line_char_len(l, col);
+    return col;
+}
+
+static int line_prev_col(const EditorLine *l, int col) {
+    if (l->flags & LINE_ASCII) return col - 1;
+    do {
+        if (l->flags & LINE_UTF8) {
+            do col--; while (col > 0 && (l->text[col] & 0xC0) == 0x80);
+        } else {
+            // Mixed valid and invalid bytes: back up to a sequence ending at col
+            int k = 4;
+            while (k > 1 && !(col - k >= 0 && line_char_len(l, col - k) == k)) k--;
+            col -= k;
+        }
+    } while (col > 0 && line_char_width(l, col) == 0);
+    return col;
+}
+
+/*
+ * Finding the screen column of a byte offset in a non-ASCII line means
+ * decoding the line up to it. So that this costs about the width of the
+ * screen rather than the length of the line, each line keeps a mark: a
+ * character start at or before the left edge of the screen and its screen
+ * column, set while drawing the line. Lookups at or past the mark start
+ * from there. An edit before the mark drops it back to the start of the
+ * line (line_edited()).
+ */
+static int line_col_to_x(const EditorLine *l, int col) {
+    if (l->flags & LINE_ASCII) return col;
+    int i = 0, x = 0;
+    if (l->mark_col <= col) {
+        i = l->mark_col;
+        x = l->mark_x;
+    }
+    for (; i < col; i += line_char_len(l, i)) x += line_char_width(l, i);
+    return x;
+}
+
+static int line_x_to_col(const EditorLine *l, int x) {
+    // The character covering screen column x, or the end of the line
+    if (l->flags & LINE_ASCII) return x < l->len ? x : l->len;
+    int col = 0, cx = 0;
+    if (l->mark_x <= x) {
+        col = l->mark_col;
+        cx = l->mark_x;
+    }
+    while (col < l->len) {
+        int w = line_char_width(l, col);
+        if (cx + w > x) break;
+        cx += w;
+        col = line_next_col(l, col);
+    }
+    return col;
+}
+
+static void line_edited(EditorLine *l, int at) {
+    // The text from byte at onwards changed; the mark stays good before it
+    if (l->mark_col > at) l->mark_col = l->mark_x = 0;
+}
+
+void editor_insert_line_len(int at, const char *s, int len) {
     if (at < 0 || at > E.numlines) return;
-    E.lines = realloc(E.lines, sizeof(char*) * (E.numlines + 1));
-    memmove(&E.lines[at+1], &E.lines[at], sizeof(char*) * (E.numlines - at));
-    E.lines[at] = strdup(s);
+    if (E.numlines == E.linecap) {
+        E.linecap = E.linecap ? E.linecap * 2 : 64;
+        E.lines = realloc(E.lines, sizeof(EditorLine) * E.linecap);
+    }
+    memmove(&E.lines[at+1], &E.lines[at], sizeof(EditorLine) * (E.numlines - at));
+    EditorLine *l = &E.lines[at];
+    l->text = malloc(len + 1);
+    memcpy(l->text, s, len);
+    l->text[len] = '\0';
+    l->len = len;
+    l->cap = len + 1;
+    l->mark_col = l->mark_x = 0;
+    line_update_flags(l);
     E.numlines++;
     E.modified = 1;
 }
 
+void editor_insert_line(int at, const char *s) {
+    editor_insert_line_len(at, s, (int)strlen(s));
+}
+
 void editor_delete_line(int at) {
-    if (at < 0 || at >= E.numlines) return;
-    free(E.lines[at]);
-    memmove(&E.lines[at], &E.lines[at+1], sizeof(char*) * (E.numlines - at - 1));
-    E.numlines--;
+    editor_delete_lines(at, 1);
+}
+
+void editor_delete_lines(int at, int count) {
+    // Lines past the end are ignored; the rest of the array moves once
+    if (at < 0 || at >= E.numlines || count <= 0) return;
+    if (count > E.numlines - at) count = E.numlines - at;
+    for (int i = at; i < at + count; i++) free(E.lines[i].text);
+    memmove(&E.lines[at], &E.lines[at+count], sizeof(EditorLine) * (E.numlines - at - count));
+    E.numlines -= count;
     E.modified = 1;
     if (E.numlines == 0) {
         editor_insert_line(0, "");
     }
 }
 
+int editor_replace_all(const char *from, const char *to) {
+    // Replace every occurrence of from (not empty) on every line; returns
+    // how many were replaced. The cursor is moved to the start of its line.
+    int flen = (int)strlen(from), tlen = (int)strlen(to);
+    int count = 0;
+    char *buf = NULL;
+    int bufcap = 0;
+    for (int i = 0; i < E.numlines; i++) {
+        EditorLine *l = &E.lines[i];
+        int used = 0, start = 0, found = 0;
+        for (int j = 0; j + flen <= l->len; ) {
+            const char *p = memchr(l->text + j, from[0], l->len - flen + 1 - j);
+            if (p == NULL) break;
+            j = (int)(p - l->text);
+            if (memcmp(p, from, flen) != 0) {
+                j++;
+                continue;
+            }
+            int need = used + (j - start) + tlen + (l->len - j - flen) + 1;
+            if (need > bufcap) {
+                bufcap = need * 2;
+                buf = realloc(buf, bufcap);
+            }
+            memcpy(buf + used, l->text + start, j - start);
+            used += j - start;
+            memcpy(buf + used, to, tlen);
+            used += tlen;
+            j += flen;
+            start = j;
+            found++;
+        }
+        if (!found) continue;
+        line_reserve(l, used + (l->len - start) + 1);
+        memcpy(buf + used, l->text + start, l->len - start);
+        used += l->len - start;
+        memcpy(l->text, buf, used);
+        l->text[used] = '\0';
+        l->len = used;
+        line_edited(l, 0);
+        line_update_flags(l);
+        count += found;
+    }
+    free(buf);
+    if (count > 0) {
+        E.col = 0;
+        E.modified = 1;
+    }
+    return count;
+}
+
+static uint32_t hash_line(const EditorLine *l) {
+    // FNV-1a, good enough for bucketing lines
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < l->len; i++) {
+        h ^= (unsigned char)l->text[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void editor_dedupe_lines(void) {
+    // Remove duplicate lines, keeping the first occurrence of each in its
+    // original position. The first pass looks every line up in an
+    // open-addressing table of lines seen so far and builds a keep-mask
+    // without touching the buffer, so it can be cancelled for free. The
+    // second pass compacts the line array and frees the duplicates.
+    //
+    // The table is a power of two with at least two slots per line, of 8
+    // bytes each (hash and index): 16-32 bytes per line, about 1 GiB for
+    // 50M lines. The first pass only reads the buffer and could be split
+    // across threads by hash, but the editor has no threads and Ctrl+C
+    // and the progress display are handled from this loop, so it runs on
+    // one thread.
+    size_t nslots = 16;
+    while (nslots < (size_t)E.numlines * 2) nslots <<= 1;
+    uint32_t *hashes = malloc(sizeof(uint32_t) * nslots);
+    int *slots = malloc(sizeof(int) * nslots); // line index + 1, 0 = empty
+    unsigned char *keep = malloc(E.numlines);
+    if (!hashes || !slots || !keep) {
+        free(hashes);
+        free(slots);
+        free(keep);
+        editor_status_message("Error: Not enough memory to remove duplicates!");
+        return;
+    }
+    memset(slots, 0, sizeof(int) * nslots);
+
+    editor_progress_begin(1);
+    long long pending = 0; // bytes since the last progress check
+    for (int i = 0; i < E.numlines; i++) {
+        const EditorLine *line = &E.lines[i];
+        pending += line->len + 1;
+        uint32_t h = hash_line(line);
+        size_t pos = h & (nslots - 1);
+        keep[i] = 1;
+        while (slots[pos]) {
+            const EditorLine *seen = &E.lines[slots[pos] - 1];
+            if (hashes[pos] == h && seen->len == line->len &&
+                memcmp(seen->text, line->text, line->len) == 0) {
+                keep[i] = 0;
+                break;
+            }
+            pos = (pos + 1) & (nslots - 1);
+        }
+        if (keep[i]) {
+            hashes[pos] = h;
+            slots[pos] = i + 1;
+        }
+        if ((i + 1) % PROGRESS_CHUNK == 0 || pending >= PROGRESS_BYTES) {
+            pending = 0;
+            if (editor_progress("Removing duplicates", i + 1, E.numlines)) {
+                free(hashes);
+                free(slots);
+                free(keep);
+                editor_status_message("Dedupe cancelled.");
+                return;
+            }
+        }
+    }
+    free(hashes);
+    free(slots);
+
+    int x = line_col_to_x(&E.lines[E.row], E.col);
+    int kept = 0;
+    int cursor_row = 0;
+    for (int i = 0; i < E.numlines; i++) {
+        if (!keep[i]) {
+            free(E.lines[i].text);
+            continue;
+        }
+        if (i <= E.row) cursor_row = kept;
+        E.lines[kept++] = E.lines[i];
+    }
+    free(keep);
+
+    int removed = E.numlines - kept;
+    E.numlines = kept;
+    E.row = cursor_row;
+    E.col = line_x_to_col(&E.lines[E.row], x);
+    if (removed > 0) E.modified = 1;
+
+    char msg[64];
+    snprintf(msg, sizeof(msg), "Removed %d duplicate line%s", removed, removed == 1 ? "" : "s");
+    editor_status_message(msg);
+}
+
 void editor_insert_char(char ch) {
     if (E.row < 0 || E.row >= E.numlines) return;
 
-    char *line = E.lines[E.row];
-    int len = (int)strlen(line);
+    EditorLine *line = &E.lines[E.row];
 
     if (E.col < 0) E.col = 0;
-    if (E.col > len) E.col = len;
-
-    char *newline = malloc(len + 2);
-    memcpy(newline, line, E.col);
-    newline[E.col] = ch;
-    memcpy(&newline[E.col+1], &line[E.col], len - E.col + 1);
+    if (E.col > line->len) E.col = line->len;
 
-    free(E.lines[E.row]);
-    E.lines[E.row] = newline;
+    line_reserve(line, line->len + 2);
+    line_edited(line, E.col);
+    memmove(&line->text[E.col+1], &line->text[E.col], line->len - E.col + 1);
+    line->text[E.col] = ch;
+    line->len++;
     E.col++;
     E.modified = 1;
 }
@@ -216,30 +1336,30 @@ void editor_delete_char(void) {
     if (E.row < 0 || E.row >= E.numlines) return;
     if (E.col == 0 && E.row == 0) return;
 
-    char *line = E.lines[E.row];
-    int len = (int)strlen(line);
+    EditorLine *line = &E.lines[E.row];
 
     if (E.col > 0) {
         // Delete character before cursor in the same line
-        char *newline = malloc(len);
-        memcpy(newline, line, E.col - 1);
-        memcpy(&newline[E.col-1], &line[E.col], len - E.col + 1);
-        free(E.lines[E.row]);
-        E.lines[E.row] = newline;
-        E.col--;
+        int start = line_prev_col(line, E.col);
+        line_edited(line, start);
+        memmove(&line->text[start], &line->text[E.col], line->len - E.col + 1);
+        line->len -= E.col - start;
+        E.col = start;
+        if (!(line->flags & LINE_UTF8)) line_update_flags(line);
         E.modified = 1;
     } else {
         // At the beginning of a line, we merge this line with the previous one
-        int prev_len = (int)strlen(E.lines[E.row - 1]);
-        char *newline = malloc(prev_len + len + 1);
-        strcpy(newline, E.lines[E.row - 1]);
-        strcat(newline, line);
-        free(E.lines[E.row - 1]);
-        free(E.lines[E.row]);
-        memmove(&E.lines[E.row-1], &E.lines[E.row], sizeof(char*) * (E.numlines - E.row));
+        EditorLine *prev = &E.lines[E.row - 1];
+        int prev_len = prev->len;
+        line_reserve(prev, prev->len + line->len + 1);
+        line_edited(prev, prev->len);
+        memcpy(&prev->text[prev->len], line->text, line->len + 1);
+        prev->len += line->len;
+        if ((prev->flags & line->flags & LINE_ASCII) == 0)
+            line_update_flags(prev);
+        free(line->text);
+        memmove(&E.lines[E.row], &E.lines[E.row+1], sizeof(EditorLine) * (E.numlines - E.row - 1));
         E.numlines--;
-        E.lines[E.numlines] = NULL;
-        E.lines[E.row - 1] = newline;
         E.row--;
         E.col = prev_len;
         E.modified = 1;
@@ -247,28 +1367,28 @@ void editor_delete_char(void) {
 }
 
 void editor_move_cursor(int key) {
+    // Up and down keep the cursor in the same screen column
+    int x = line_col_to_x(&E.lines[E.row], E.col);
     switch (key) {
         case KEY_UP:
             if (E.row > 0) E.row--;
-            if (E.col > (int)strlen(E.lines[E.row]))
-                E.col = (int)strlen(E.lines[E.row]);
+            E.col = line_x_to_col(&E.lines[E.row], x);
             break;
         case KEY_DOWN:
             if (E.row < E.numlines - 1) E.row++;
-            if (E.col > (int)strlen(E.lines[E.row]))
-                E.col = (int)strlen(E.lines[E.row]);
+            E.col = line_x_to_col(&E.lines[E.row], x);
             break;
         case KEY_LEFT:
             if (E.col > 0) {
-                E.col--;
+                E.col = line_prev_col(&E.lines[E.row], E.col);
             } else if (E.row > 0) {
                 E.row--;
-                E.col = (int)strlen(E.lines[E.row]);
+                E.col = E.lines[E.row].len;
             }
             break;
         case KEY_RIGHT:
-            if (E.col < (int)strlen(E.lines[E.row])) {
-                E.col++;
+            if (E.col < E.lines[E.row].len) {
+                E.col = line_next_col(&E.lines[E.row], E.col);
             } else if (E.row < E.numlines - 1) {
                 E.row++;
                 E.col = 0;
@@ -277,13 +1397,111 @@ void editor_move_cursor(int key) {
     }
 }
 
+/*
+ * Word boundaries come from a 256-entry table rather than isalnum(), so the
+ * inner loops are one load and compare per byte. Bytes >= 0x80 count as word
+ * characters, which keeps UTF-8 letters together and means a word boundary
+ * never falls inside a multi-byte character.
+ */
+static unsigned char word_chars[256];
+
+static int is_word_char(unsigned char c) {
+    if (!word_chars['a']) {
+        for (int i = 0; i < 256; i++)
+            word_chars[i] = i >= 0x80 || i == '_' || (i < 0x80 && isalnum(i));
+    }
+    return word_chars[c];
+}
+
+static int word_end(const EditorLine *l, int col) {
+    // Skip the rest of the current word, then the gap to the next one
+    while (col < l->len && is_word_char(l->text[col])) col++;
+    while (col < l->len && !is_word_char(l->text[col])) col++;
+    return col;
+}
+
+static int word_start(const EditorLine *l, int col) {
+    // Skip the gap before the cursor, then back to the start of that word
+    while (col > 0 && !is_word_char(l->text[col-1])) col--;
+    while (col > 0 && is_word_char(l->text[col-1])) col--;
+    return col;
+}
+
+void editor_move_word(int forward) {
+    if (forward) {
+        if (E.col >= E.lines[E.row].len) {
+            if (E.row == E.numlines - 1) return;
+            E.row++;
+            E.col = 0;
+            // Land on the first word of the next line, like nano
+            while (E.col < E.lines[E.row].len && !is_word_char(E.lines[E.row].text[E.col]))
+                E.col++;
+        } else {
+            E.col = word_end(&E.lines[E.row], E.col);
+        }
+    } else {
+        if (E.col == 0) {
+            if (E.row == 0) return;
+            E.row--;
+            E.col = E.lines[E.row].len;
+        }
+        E.col = word_start(&E.lines[E.row], E.col);
+    }
+}
+
+void editor_delete_word(int forward) {
+    // Delete from the cursor to where editor_move_word() would go, as one
+    // range. At a line boundary this joins lines like Backspace does.
+    EditorLine *line = &E.lines[E.row];
+    int from, to;
+    if (forward) {
+        if (E.col >= line->len) {
+            if (E.row == E.numlines - 1) return;
+            E.row++;
+            E.col = 0;
+            editor_delete_char();
+            return;
+        }
+        from = E.col;
+        to = word_end(line, E.col);
+    } else {
+        if (E.col == 0) {
+            editor_delete_char();
+            return;
+        }
+        from = word_start(line, E.col);
+        to = E.col;
+    }
+    line_edited(line, from);
+    memmove(&line->text[from], &line->text[to], line->len - to + 1);
+    line->len -= to - from;
+    if (!(line->flags & LINE_UTF8)) line_update_flags(line);
+    E.col = from;
+    E.modified = 1;
+}
+
+#ifdef ALLOC_STATS
+static int key_alloc_op(int c) {
+    if (c == 15) return OP_SAVE;
+    if (c == 20) return OP_DEDUPE;
+    if (c == 8 || (c > 0 && (c == key_ctrl_delete || c == key_ctrl_left || c == key_ctrl_right)))
+        return OP_WORD;
+    switch (c) {
+        case KEY_UP: case KEY_DOWN: case KEY_LEFT: case KEY_RIGHT: return OP_MOVE;
+        case KEY_BACKSPACE: case 127: return OP_DELETE_CHAR;
+        case '\r': case '\n': return OP_NEWLINE;
+    }
+    return isprint(c) ? OP_INSERT_CHAR : OP_OTHER;
+}
+#endif
 
 void editor_process_key(int c) {
+    ALLOC_OP(key_alloc_op(c));
     if (c == 24) { // Ctrl+X
         // Exit
         if (E.modified) {
             editor_status_message("File modified. Ctrl+O to save, Ctrl+X to exit without saving.");
-            int c2 = getch();
+            int c2 = editor_read_key();
             if (c2 != 24) return;
         }
         endwin();
@@ -292,9 +1510,26 @@ void editor_process_key(int c) {
     } else if (c == 15) { // Ctrl+O to save
         editor_save_file();
         return;
+    } else if (c == 20) { // Ctrl+T to remove duplicate lines
+        editor_dedupe_lines();
+        return;
+    } else if (c == 8) { // Ctrl+Backspace (sent as ^H by most terminals)
+        editor_delete_word(0);
+        return;
+    } else if (c > 0 && c == key_ctrl_delete) {
+        editor_delete_word(1);
+        return;
+    } else if (c > 0 && (c == key_ctrl_left || c == key_ctrl_right)) {
+        editor_move_word(c == key_ctrl_right);
+        return;
     }
 
     switch (c) {
+        case KEY_RESIZE:
+            getmaxyx(stdscr, E.screenrows, E.screencols);
+            E.screenrows -= 3;
+            clear();
+            break;
         case KEY_UP:
         case KEY_DOWN:
         case KEY_LEFT:
@@ -309,11 +1544,7 @@ void editor_process_key(int c) {
         case '\n':  // Line Feed (ASCII 10)
             // Move down one line, creating a new line if at the bottom
             if (E.row < E.numlines - 1) {
-                E.row++;
-                int line_len = (int)strlen(E.lines[E.row]);
-                if (E.col > line_len) {
-                    E.col = line_len;
-                }
+                editor_move_cursor(KEY_DOWN);
             } else {
                 // If at the last line, add a new empty line
                 editor_insert_line(E.numlines, "");
@@ -329,19 +1560,89 @@ void editor_process_key(int c) {
     }
 }
 
+static void draw_run(const char *text, int len, int invalid) {
+    // One attribute change and one output call per run of same-style text
+    static const char marks[] = "????????????????????????????????";
+    if (!invalid) {
+        addnstr(text, len);
+        return;
+    }
+    attron(A_REVERSE);
+    for (int n; len > 0; len -= n) {
+        n = len < (int)sizeof(marks) - 1 ? len : (int)sizeof(marks) - 1;
+        addnstr(marks, n);
+    }
+    attroff(A_REVERSE);
+}
+
+static void editor_draw_utf8_row(EditorLine *line) {
+    // Walk the line a character at a time and split it into runs of valid
+    // text (drawn as is) and invalid bytes or non-printing characters
+    // (drawn as one highlighted '?' each, so runlen counts cells for those
+    // runs). Each run is drawn with a single call. A wide character cut by either edge of the screen is left out,
+    // with a blank for its visible half on the left. The walk starts at the
+    // line's mark when that is left of the screen and moves the mark up to
+    // the left edge, so it covers about one screen width per frame.
+    const char *run = NULL;
+    int runlen = 0, runinvalid = 0;
+    int end = E.leftcol + E.screencols;
+    int i = 0, x = 0, len;
+    if (line->mark_x <= E.leftcol) {
+        i = line->mark_col;
+        x = line->mark_x;
+    }
+    for (; i < line->len && x < end; i += len) {
+        int w = char_width((const unsigned char *)line->text + i, line->len - i, &len);
+        int invalid = w < 0;
+        if (invalid) {
+            w = 1;  // char_width() gave the bytes to skip in len
+        } else if (w == 0) {
+            // A combining mark is drawn with the character it follows
+            if (run && !runinvalid) runlen += len;
+            continue;
+        }
+        if (x <= E.leftcol) {
+            line->mark_col = i;
+            line->mark_x = x;
+        }
+        if (x + w > end) break;
+        if (x < E.leftcol && x + w > E.leftcol) {
+            addnstr("  ", x + w - E.leftcol);
+        } else if (x >= E.leftcol) {
+            if (run && invalid != runinvalid) {
+                draw_run(run, runlen, runinvalid);
+                run = NULL;
+            }
+            if (!run) {
+                run = line->text + i;
+                runlen = 0;
+                runinvalid = invalid;
+            }
+            runlen += invalid ? 1 : len;
+        }
+        x += w;
+    }
+    if (run) draw_run(run, runlen, runinvalid);
+}
+
 void editor_draw_rows(void) {
     for (int y = 0; y < E.screenrows; y++) {
         int filerow = E.topline + y;
         move(y, 0);
         clrtoeol();
         if (filerow < E.numlines) {
-            char *line = E.lines[filerow];
-            int len = (int)strlen(line);
-            if (len > E.leftcol) {
-                int drawlen = len - E.leftcol;
-                if (drawlen > E.screencols) drawlen = E.screencols;
-                for (int i = 0; i < drawlen; i++)
-                    addch(line[E.leftcol + i]);
+            // Only the visible slice is drawn, so a very long line costs no
+            // more than a short one (for a non-ASCII line, once its mark
+            // has caught up with the left edge; see line_col_to_x()).
+            EditorLine *line = &E.lines[filerow];
+            if (line->flags & LINE_ASCII) {
+                if (line->len > E.leftcol) {
+                    int drawlen = line->len - E.leftcol;
+                    if (drawlen > E.screencols) drawlen = E.screencols;
+                    addnstr(line->text + E.leftcol, drawlen);
+                }
+            } else {
+                editor_draw_utf8_row(line);
             }
         }
     }
@@ -351,21 +1652,25 @@ void editor_draw_status_bar(void) {
     attron(A_REVERSE);
     char status[80];
     int len;
+    const char *enc = E.encoding == ENC_LATIN1 ? "[Latin-1] " :
+                      E.encoding == ENC_UTF16LE ? "[UTF-16LE] " : "";
     if (E.filename)
-        len = snprintf(status, sizeof(status), "File: %s %s", E.filename, E.modified ? "(modified)" : "");
+        len = snprintf(status, sizeof(status), "File: %s %s%s", E.filename, enc, E.modified ? "(modified)" : "");
     else
-        len = snprintf(status, sizeof(status), "File: (No Name) %s", E.modified ? "(modified)" : "");
+        len = snprintf(status, sizeof(status), "File: (No Name) %s%s", enc, E.modified ? "(modified)" : "");
     int rlen = len;
+    if (rlen > (int)sizeof(status) - 1) rlen = sizeof(status) - 1;
     if (rlen > E.screencols) rlen = E.screencols;
-    move(E.screenrows, 0);
-    for (int i = 0; i < rlen; i++) addch(status[i]);
-    for (int i = rlen; i < E.screencols; i++) addch(' ');
+    // Text and padding as one run each rather than a call per cell
+    mvaddnstr(E.screenrows, 0, status, rlen);
+    if (rlen < E.screencols)
+        hline(' ' | A_REVERSE, E.screencols - rlen);
     attroff(A_REVERSE);
 
     // Display a help line (like nano)
     move(E.screenrows+2, 0);
     clrtoeol();
-    printw("^X Exit  ^O Save");
+    printw("^X Exit  ^O Save  ^T Dedupe");
 }
 
 void editor_scroll(void) {
@@ -376,20 +1681,629 @@ void editor_scroll(void) {
         E.topline = E.row - E.screenrows + 1;
     }
 
-    if (E.col < E.leftcol) {
-        E.leftcol = E.col;
-    }
-    if (E.col >= E.leftcol + E.screencols) {
-        E.leftcol = E.col - E.screencols + 1;
+    // Scroll horizontally in half-screen jumps like nano, so moving or
+    // typing past the edge repaints the rows once per half screen instead
+    // of on every key.
+    E.cx = line_col_to_x(&E.lines[E.row], E.col);
+    if (E.cx < E.leftcol || E.cx >= E.leftcol + E.screencols) {
+        E.leftcol = E.cx - E.screencols / 2;
+        if (E.leftcol < 0) E.leftcol = 0;
     }
 }
 
 void editor_refresh_screen(void) {
+    ALLOC_OP(OP_DRAW);
     editor_scroll();
     editor_draw_rows();
     editor_draw_status_bar();
-    move(E.row - E.topline, E.col - E.leftcol);
+    move(E.row - E.topline, E.cx - E.leftcol);
+
+    // Bracket the frame in a synchronized update (DEC mode 2026) so the
+    // terminal shows it all at once instead of tearing; terminals without
+    // it ignore the mode. ncurses has flushed everything by the time
+    // refresh() returns, so writing the markers directly keeps the order.
+    write_all(term_outfd, "\033[?2026h", 8);
     refresh();
+    write_all(term_outfd, "\033[?2026l", 8);
+}
+
+/*
+ * Benchmark mode. Each primitive is run against the real buffer, with
+ * ncurses drawing into /dev/null, and reported with wall time per
+ * operation and, where the kernel allows perf_event_open(), IPC, cache
+ * misses and branch miss rate. Without counters (other OSes, containers,
+ * perf_event_paranoid) the counter columns show n/a.
+ */
+enum { PC_CYCLES, PC_INSTRUCTIONS, PC_CACHE_MISSES, PC_BRANCHES, PC_BRANCH_MISSES, PC_COUNT };
+
+typedef struct {
+    int fd[PC_COUNT];
+    int ok;
+    uint64_t val[PC_COUNT];
+} PerfCounters;
+
+static void perf_open(PerfCounters *pc) {
+    pc->ok = 0;
+    for (int i = 0; i < PC_COUNT; i++) pc->fd[i] = -1;
+#ifdef __linux__
+    static const uint64_t config[PC_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_MISSES
+    };
+    for (int i = 0; i < PC_COUNT; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config[i];
+        attr.disabled = i == 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        pc->fd[i] = syscall(__NR_perf_event_open, &attr, 0, -1, i == 0 ? -1 : pc->fd[0], 0);
+        if (pc->fd[i] < 0) {
+            while (i-- > 0) close(pc->fd[i]);
+            return;
+        }
+    }
+    pc->ok = 1;
+#endif
+}
+
+static void perf_start(PerfCounters *pc) {
+#ifdef __linux__
+    if (!pc->ok) return;
+    ioctl(pc->fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(pc->fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+static void perf_stop(PerfCounters *pc) {
+#ifdef __linux__
+    if (!pc->ok) return;
+    ioctl(pc->fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    uint64_t buf[1 + PC_COUNT];
+    if (read(pc->fd[0], buf, sizeof(buf)) != (ssize_t)sizeof(buf)) {
+        memset(pc->val, 0, sizeof(pc->val));
+        return;
+    }
+    memcpy(pc->val, buf + 1, sizeof(pc->val));
+#endif
+}
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void bench_report(const char *name, long ops, long long ns, const PerfCounters *pc) {
+    printf("%-12s %9ld %12.3f %12.1f", name, ops, ns / 1e6, (double)ns / ops);
+    if (pc->ok && pc->val[PC_CYCLES]) {
+        const uint64_t *v = pc->val;
+        printf(" %6.2f %14.1f %9.2f%%\n",
+               (double)v[PC_INSTRUCTIONS] / v[PC_CYCLES],
+               (double)v[PC_CACHE_MISSES] / ops,
+               v[PC_BRANCHES] ? 100.0 * v[PC_BRANCH_MISSES] / v[PC_BRANCHES] : 0.0);
+    } else {
+        printf(" %6s %14s %10s\n", "n/a", "n/a", "n/a");
+    }
+}
+
+#define BENCH(name, ops, body) do {                     \
+        perf_start(&pc);                                \
+        long long t0_ = now_ns();                       \
+        body;                                           \
+        long long t1_ = now_ns();                       \
+        perf_stop(&pc);                                 \
+        bench_report(name, ops, t1_ - t0_, &pc);        \
+    } while (0)
+
+void editor_report_startup(long long start, long long after_initscr,
+                           long long after_init, long long after_frame) {
+    printf("%-28s %9.3f ms\n", "initscr (incl. terminfo)", (after_initscr - start) / 1e6);
+    printf("%-28s %9.3f ms\n", "editor_init (excl. load)", (after_init - after_initscr - startup_load_ns) / 1e6);
+    printf("%-28s %9.3f ms\n", "editor_load_file", startup_load_ns / 1e6);
+    printf("%-28s %9.3f ms\n", "first editor_refresh_screen", (after_frame - after_init) / 1e6);
+    printf("%-28s %9.3f ms\n", "total to first frame", (after_frame - start) / 1e6);
+}
+
+static SCREEN *bench_screen(FILE **devnull) {
+    // An ncurses screen that draws into /dev/null, so drawing and status
+    // messages run their real code paths without a terminal.
+    *devnull = fopen("/dev/null", "w");
+    if (!*devnull) return NULL;
+    SCREEN *scr = newterm(NULL, *devnull, stdin);
+    if (!scr) scr = newterm("xterm", *devnull, stdin);
+    if (!scr) {
+        fclose(*devnull);
+        return NULL;
+    }
+    set_term(scr);
+    term_outfd = fileno(*devnull);
+    return scr;
+}
+
+static void bench_clear_buffer(void) {
+    // An empty buffer rather than the usual single empty line, so that
+    // editor_load_file() starts from nothing
+    while (E.numlines > 0) free(E.lines[--E.numlines].text);
+    E.row = E.col = E.topline = E.leftcol = 0;
+}
+
+int editor_bench(const char *filename) {
+    FILE *devnull;
+    SCREEN *scr = bench_screen(&devnull);
+    if (!scr) {
+        fprintf(stderr, "nano-clone: cannot set up a terminal for benchmarking\n");
+        return 1;
+    }
+    editor_init(NULL);
+    bench_clear_buffer();
+
+    PerfCounters pc;
+    perf_open(&pc);
+    if (!pc.ok)
+        fprintf(stderr, "nano-clone: hardware counters unavailable (%s)\n", strerror(errno));
+    printf("%-12s %9s %12s %12s %6s %14s %10s\n",
+           "primitive", "ops", "total ms", "ns/op", "IPC", "cache miss/op", "br miss");
+
+    BENCH("load", 1, editor_load_file(filename));
+    if (E.numlines == 0) editor_insert_line(0, "");
+    int mid = E.numlines / 2;
+    long n = 100000;
+
+    // Start in the middle of the line, on a character boundary
+    E.row = mid;
+    E.col = line_x_to_col(&E.lines[mid], line_col_to_x(&E.lines[mid], E.lines[mid].len) / 2);
+    BENCH("insert char", n, for (long i = 0; i < n; i++) editor_insert_char('x'));
+    BENCH("delete char", n, for (long i = 0; i < n; i++) editor_delete_char());
+
+    long nl = 1000;
+    BENCH("insert line", nl, for (long i = 0; i < nl; i++) editor_insert_line(mid, "benchmark line"));
+    BENCH("delete line", nl, for (long i = 0; i < nl; i++) editor_delete_line(mid));
+
+    // Page through the file so every frame has new content to draw
+    long frames = 1000;
+    E.col = 0;
+    BENCH("draw rows", frames, for (long i = 0; i < frames; i++) {
+        E.row = (int)((i * E.screenrows) % E.numlines);
+        editor_refresh_screen();
+    });
+
+    // Save to a scratch file next to the original, then remove it
+    free(E.filename);
+    E.filename = malloc(strlen(filename) + 7);
+    sprintf(E.filename, "%s.bench", filename);
+    BENCH("save", 1, editor_save_file());
+    unlink(E.filename);
+
+    endwin();
+    delscreen(scr);
+    fclose(devnull);
+    editor_free();
+    return 0;
+}
+
+/*
+ * Synthetic workloads. Each generator writes lines of one shape until the
+ * file reaches the requested size; the content is pseudo-random but the
+ * same for a given kind and size.
+ */
+static uint32_t gen_state;
+
+static uint32_t gen_rand(uint32_t n) {
+    gen_state = gen_state * 1103515245u + 12345u;
+    return (gen_state >> 8) % n;
+}
+
+static size_t gen_words(char *out, int count) {
+    static const char *const words[] = {
+        "alpha", "request", "timeout", "user", "cache", "miss", "ok", "retry",
+        "connection", "closed", "value", "x", "payload", "worker", "queue", "done"
+    };
+    size_t n = 0;
+    for (int i = 0; i < count; i++)
+        n += sprintf(out + n, i ? " %s" : "%s", words[gen_rand(16)]);
+    return n;
+}
+
+static size_t gen_line(const char *kind, char *out) {
+    // Writes one line (or, for "longline", one chunk of the single line)
+    // into out, which has room for 4 KiB. Returns its length.
+    static const char *const utf8_words[] = {
+        "naïve", "café", "日本語", "Привет", "😀", "Ελληνικά", "straße", "ok"
+    };
+    size_t n = 0;
+    if (strcmp(kind, "logs") == 0 || strcmp(kind, "crlf") == 0) {
+        n = sprintf(out, "2026-10-18T%02u:%02u:%02u.%03uZ %s [worker-%u] ",
+                    gen_rand(24), gen_rand(60), gen_rand(60), gen_rand(1000),
+                    gen_rand(10) ? "INFO" : "WARN", gen_rand(64));
+        n += gen_words(out + n, 2 + gen_rand(gen_rand(10) ? 12 : 120));
+        if (kind[0] == 'c') out[n++] = '\r';
+        out[n++] = '\n';
+    } else if (strcmp(kind, "longline") == 0) {
+        n = gen_words(out, 64);
+        out[n++] = ' ';
+    } else if (strcmp(kind, "csv") == 0) {
+        n = sprintf(out, "%u,user%u,%u.%02u,%s\n", gen_rand(1000000), gen_rand(50000),
+                    gen_rand(10000), gen_rand(100), gen_rand(2) ? "true" : "false");
+    } else if (strcmp(kind, "utf8") == 0) {
+        for (int i = 0, count = 4 + gen_rand(16); i < count; i++)
+            n += sprintf(out + n, i ? " %s" : "%s", utf8_words[gen_rand(8)]);
+        out[n++] = '\n';
+    } else if (strcmp(kind, "dup") == 0) {
+        uint32_t pick = gen_rand(100);  // one of 100 distinct lines
+        uint32_t saved = gen_state;
+        gen_state = pick + 1;
+        n = gen_words(out, 8);
+        gen_state = saved;
+        out[n++] = '\n';
+    }
+    return n;
+}
+
+static int gen_check_kind(const char *kind) {
+    char line[4096];
+    gen_state = 1;
+    if (gen_line(kind, line) == 0) {
+        fprintf(stderr, "nano-clone: unknown kind '%s' (logs, longline, csv, utf8, crlf, dup)\n", kind);
+        return -1;
+    }
+    return 0;
+}
+
+int editor_generate(const char *kind, long long bytes, const char *filename) {
+    char line[4096];
+    if (gen_check_kind(kind) != 0) return 1;
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        fprintf(stderr, "nano-clone: %s: %s\n", filename, strerror(errno));
+        return 1;
+    }
+    char *out = malloc(IO_CHUNK + 1); // room for longline's final newline
+    size_t used = 0;
+    long long written = 0;
+    int failed = 0;
+    gen_state = 1;
+    while (written + (long long)used < bytes && !failed) {
+        size_t n = gen_line(kind, line);
+        if (used + n > IO_CHUNK) {
+            failed = write_all(fd, out, used);
+            written += used;
+            used = 0;
+        }
+        memcpy(out + used, line, n);
+        used += n;
+    }
+    if (strcmp(kind, "longline") == 0) out[used++] = '\n';
+    if (!failed) failed = write_all(fd, out, used);
+    free(out);
+    if (close(fd) != 0 || failed) {
+        fprintf(stderr, "nano-clone: %s: write failed\n", filename);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Scaling suite: for files of 1, 4, 16, ... MiB up to max_mb, time loading,
+ * saving and dedupe (expected linear in size) and per-operation costs of
+ * inserting characters and lines and of drawing a frame (expected constant).
+ * A least-squares fit of log(time) against log(size) gives each primitive's
+ * growth exponent; anything clearly above what it should be is flagged.
+ */
+enum { SC_LOAD, SC_SAVE, SC_DEDUPE, SC_INSERT_CHAR, SC_INSERT_LINE, SC_DRAW, SC_COUNT };
+
+static const struct {
+    const char *name;
+    double expected;    // growth exponent in file size
+} scale_ops[SC_COUNT] = {
+    { "load", 1 }, { "save", 1 }, { "dedupe", 1 },
+    { "insert char", 0 }, { "insert line", 0 }, { "draw frame", 0 }
+};
+
+int editor_bench_scale(const char *kind, int max_mb) {
+    enum { MAX_SIZES = 16 };
+    double logsize[MAX_SIZES], logtime[SC_COUNT][MAX_SIZES];
+    int nsizes = 0, failed = 0;
+
+    if (gen_check_kind(kind) != 0) return 1;
+    if (max_mb < 1) {
+        fprintf(stderr, "nano-clone: MAX_MB must be at least 1\n");
+        return 1;
+    }
+    FILE *devnull;
+    SCREEN *scr = bench_screen(&devnull);
+    if (!scr) {
+        fprintf(stderr, "nano-clone: cannot set up a terminal for benchmarking\n");
+        return 1;
+    }
+    editor_init(NULL);
+
+    char path[] = "/tmp/nano-clone-scale.XXXXXX";
+    int tmpfd = mkstemp(path);
+    if (tmpfd < 0) {
+        endwin();
+        fprintf(stderr, "nano-clone: cannot create a scratch file\n");
+        return 1;
+    }
+    close(tmpfd);
+    char *savepath = malloc(strlen(path) + 6);
+    sprintf(savepath, "%s.save", path);
+
+    printf("%-8s", "MiB");
+    for (int op = 0; op < SC_COUNT; op++) printf(" %14s", scale_ops[op].name);
+    printf("\n%-8s", "");
+    for (int op = 0; op < SC_COUNT; op++) printf(" %14s", scale_ops[op].expected ? "total ms" : "us/op");
+    printf("\n");
+
+    for (int mb = 1; mb <= max_mb && nsizes < MAX_SIZES; mb *= 4) {
+        if (editor_generate(kind, (long long)mb << 20, path) != 0) {
+            failed = 1;
+            break;
+        }
+        bench_clear_buffer();
+        double t[SC_COUNT];
+        long long t0 = now_ns();
+        editor_load_file(path);
+        t[SC_LOAD] = (now_ns() - t0) / 1e6;
+
+        free(E.filename);
+        E.filename = strdup(savepath);
+        t0 = now_ns();
+        editor_save_file();
+        t[SC_SAVE] = (now_ns() - t0) / 1e6;
+
+        int mid = E.numlines / 2;
+        long n = 10000;
+        E.row = mid;
+        E.col = line_x_to_col(&E.lines[mid], line_col_to_x(&E.lines[mid], E.lines[mid].len) / 2);
+        t0 = now_ns();
+        for (long i = 0; i < n; i++) editor_insert_char('x');
+        t[SC_INSERT_CHAR] = (now_ns() - t0) / 1e3 / n;
+
+        n = 200;
+        t0 = now_ns();
+        for (long i = 0; i < n; i++) editor_insert_line(mid, "scaling benchmark");
+        t[SC_INSERT_LINE] = (now_ns() - t0) / 1e3 / n;
+        for (long i = 0; i < n; i++) editor_delete_line(mid);
+
+        n = 200;
+        t0 = now_ns();
+        for (long i = 0; i < n; i++) {
+            E.row = (int)((i * E.screenrows) % E.numlines);
+            E.col = 0;
+            editor_refresh_screen();
+        }
+        t[SC_DRAW] = (now_ns() - t0) / 1e3 / n;
+
+        t0 = now_ns();
+        editor_dedupe_lines();
+        t[SC_DEDUPE] = (now_ns() - t0) / 1e6;
+
+        printf("%-8d", mb);
+        for (int op = 0; op < SC_COUNT; op++) {
+            printf(" %14.3f", t[op]);
+            logtime[op][nsizes] = log(t[op] > 1e-9 ? t[op] : 1e-9);
+        }
+        printf("\n");
+        fflush(stdout);
+        logsize[nsizes++] = log(mb);
+    }
+    unlink(path);
+    unlink(savepath);
+    free(savepath);
+
+    if (nsizes >= 2) {
+        printf("\n%-14s %9s %9s\n", "primitive", "expected", "measured");
+        for (int op = 0; op < SC_COUNT; op++) {
+            double sx = 0, sy = 0, sxx = 0, sxy = 0;
+            for (int i = 0; i < nsizes; i++) {
+                sx += logsize[i];
+                sy += logtime[op][i];
+                sxx += logsize[i] * logsize[i];
+                sxy += logsize[i] * logtime[op][i];
+            }
+            double slope = (nsizes * sxy - sx * sy) / (nsizes * sxx - sx * sx);
+            printf("%-14s %9s %9s%s\n", scale_ops[op].name,
+                   scale_ops[op].expected ? "O(n)" : "O(1)",
+                   slope < 0.3 ? "O(1)" : slope < 1.3 ? "O(n)" : "O(n^k)",
+                   slope > scale_ops[op].expected + 0.3 ? "  <-- grows faster than expected" : "");
+            printf("%-14s %9.2f %9.2f\n", "", scale_ops[op].expected, slope);
+        }
+    }
+
+    endwin();
+    delscreen(scr);
+    fclose(devnull);
+    editor_free();
+    return failed || nsizes == 0;
+}
+
+/*
+ * Batch editing. "nano-clone --script SCRIPT FILE..." runs the commands in
+ * SCRIPT, one per line, against each FILE with the same buffer code the
+ * editor uses, and saves the files that changed:
+ *
+ *   s/OLD/NEW/   replace every OLD with NEW (any delimiter after the s)
+ *   d N[,M]      delete line N, or lines N to M
+ *   i N TEXT     insert TEXT as a new line before line N
+ *   a TEXT       append TEXT as a new last line
+ *   dedupe       remove duplicate lines, as Ctrl+T does
+ *
+ * Lines are numbered from 1 and lines out of range are skipped; blank
+ * lines and lines starting with # are ignored. The files are split across
+ * one worker process per CPU, since the buffer is global.
+ */
+typedef struct {
+    char op;        // 's', 'd', 'i', 'a' or 'u' (dedupe)
+    int first, last;
+    char *text;     // inserted text, or the search string for 's'
+    char *repl;     // replacement for 's'
+} ScriptCmd;
+
+static int script_parse_line(char *line, ScriptCmd *cmd) {
+    // Returns 1 for a command, 0 for a blank or comment line, -1 on error
+    memset(cmd, 0, sizeof(*cmd));
+    if (line[0] == '\0' || line[0] == '#') return 0;
+    int n = 0;
+    if (strcmp(line, "dedupe") == 0) {
+        cmd->op = 'u';
+    } else if (line[0] == 's' && line[1] != '\0') {
+        char delim = line[1];
+        char *from = line + 2;
+        char *to = strchr(from, delim);
+        char *end = to ? strchr(to + 1, delim) : NULL;
+        if (end == NULL || end[1] != '\0' || to == from) return -1;
+        *to = *end = '\0';
+        cmd->op = 's';
+        cmd->text = strdup(from);
+        cmd->repl = strdup(to + 1);
+    } else if (line[0] == 'd' && sscanf(line + 1, " %d%n", &cmd->first, &n) == 1) {
+        cmd->op = 'd';
+        cmd->last = cmd->first;
+        if (line[1 + n] == ',') {
+            int m = 0;
+            if (sscanf(line + 2 + n, "%d%n", &cmd->last, &m) != 1) return -1;
+            n += 1 + m;
+        }
+        if (line[1 + n] != '\0' || cmd->first < 1 || cmd->last < cmd->first) return -1;
+    } else if (line[0] == 'i' && sscanf(line + 1, " %d%n", &cmd->first, &n) == 1) {
+        char *text = line + 1 + n;
+        if (*text != '\0' && *text++ != ' ') return -1;
+        if (cmd->first < 1) return -1;
+        cmd->op = 'i';
+        cmd->text = strdup(text);
+    } else if (line[0] == 'a' && (line[1] == '\0' || line[1] == ' ')) {
+        cmd->op = 'a';
+        cmd->text = strdup(line[1] ? line + 2 : "");
+    } else {
+        return -1;
+    }
+    return 1;
+}
+
+static int script_run_file(const char *filename, const ScriptCmd *cmds, int ncmds) {
+    // Returns 0 on success, -1 after reporting the error on stderr
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+        return -1;
+    }
+    close(fd);
+
+    memset(&E, 0, sizeof(E));
+    E.encoding = ENC_UTF8;
+    E.filename = strdup(filename);
+    last_status[0] = '\0';
+    editor_load_file(filename);
+    E.modified = 0;
+    if (last_status[0]) {
+        fprintf(stderr, "%s: %s\n", filename, last_status);
+        editor_free();
+        return -1;
+    }
+
+    for (int c = 0; c < ncmds; c++) {
+        const ScriptCmd *cmd = &cmds[c];
+        E.row = E.col = 0;
+        switch (cmd->op) {
+            case 's':
+                editor_replace_all(cmd->text, cmd->repl);
+                break;
+            case 'd':
+                editor_delete_lines(cmd->first - 1, cmd->last - cmd->first + 1);
+                break;
+            case 'i':
+                editor_insert_line(cmd->first - 1, cmd->text);
+                break;
+            case 'a':
+                editor_insert_line(E.numlines, cmd->text);
+                break;
+            case 'u':
+                editor_dedupe_lines();
+                break;
+        }
+    }
+
+    int ret = 0;
+    if (E.modified && editor_save_file() != 0) {
+        fprintf(stderr, "%s: %s\n", filename, last_status);
+        ret = -1;
+    }
+    editor_free();
+    return ret;
+}
+
+int editor_script(const char *script, int nfiles, char **files) {
+    FILE *fp = fopen(script, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "nano-clone: %s: %s\n", script, strerror(errno));
+        return 1;
+    }
+    ScriptCmd *cmds = NULL;
+    int ncmds = 0, cap = 0, lineno = 0;
+    char *line = NULL;
+    size_t linecap = 0;
+    ssize_t len;
+    while ((len = getline(&line, &linecap, fp)) >= 0) {
+        lineno++;
+        if (len > 0 && line[len - 1] == '\n') line[--len] = '\0';
+        if (len > 0 && line[len - 1] == '\r') line[--len] = '\0';
+        if (ncmds == cap) {
+            cap = cap ? cap * 2 : 16;
+            cmds = realloc(cmds, sizeof(ScriptCmd) * cap);
+        }
+        int r = script_parse_line(line, &cmds[ncmds]);
+        if (r < 0) {
+            fprintf(stderr, "nano-clone: %s:%d: bad command: %s\n", script, lineno, line);
+            fclose(fp);
+            return 1;
+        }
+        ncmds += r;
+    }
+    (free)(line);
+    fclose(fp);
+
+    headless = 1;
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int nworkers = ncpu > 1 ? (int)ncpu : 1;
+    if (nworkers > nfiles) nworkers = nfiles;
+
+    int failed = 0;
+    if (nworkers == 1) {
+        for (int i = 0; i < nfiles; i++)
+            if (script_run_file(files[i], cmds, ncmds) != 0) failed = 1;
+    } else {
+        fflush(stdout);
+        fflush(stderr);
+        for (int w = 0; w < nworkers; w++) {
+            pid_t pid = fork();
+            if (pid < 0) {
+                // Out of processes: run this worker's share here instead
+                for (int i = w; i < nfiles; i += nworkers)
+                    if (script_run_file(files[i], cmds, ncmds) != 0) failed = 1;
+            } else if (pid == 0) {
+                int err = 0;
+                for (int i = w; i < nfiles; i += nworkers)
+                    if (script_run_file(files[i], cmds, ncmds) != 0) err = 1;
+                fflush(stderr);
+                _exit(err);
+            }
+        }
+        int status;
+        while (wait(&status) > 0)
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed = 1;
+    }
+
+    for (int c = 0; c < ncmds; c++) {
+        free(cmds[c].text);
+        free(cmds[c].repl);
+    }
+    free(cmds);
+    return failed;
 }
 
 /* and this is the end, my friend */